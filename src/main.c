@@ -5,6 +5,7 @@
 
 #include "input.h"
 #include "sim.h"
+#include "render.h"
 
 /* Taken from https://stackoverflow.com/a/8465083 */
 char* str_concat(const char *s1, const char *s2)
@@ -141,19 +142,17 @@ char *to_dynamic(char *input) {
 	return output;
 }
 
+/* Progress callback for flip_matrix */
+int print_row(ulong row, ulong rows, void *data) {
+	printf("Row %3lu/%lu computed\n", row, rows);
+	return 0;
+}
+
 void free_array(pend_state *arr) {
 	if (arr != NULL)
 		free(arr);
 }
 
-void free_matrix(triple **mtr) {
-	if (mtr != NULL) {
-		if (mtr[0] != NULL)
-			free(mtr[0]);
-		free(mtr);
-	}
-}
-
 void general_setup(sim_params *p) {
 	ulong choice;
 	while (1) {
@@ -189,7 +188,64 @@ void general_setup(sim_params *p) {
 	}
 }
 
-void full_setup(sim_params *p, triple *theta1, triple *theta2, char *csv_def, char *svg_def) {
+const char *format_name(anim_format format) {
+	switch (format) {
+		case ANIM_PNG : return "PNG frames";
+		case ANIM_PIPE : return "ffmpeg video";
+		default : return "PPM frames";
+	}
+}
+
+void anim_setup(anim_params *a) {
+	ulong choice;
+	while (1) {
+		printf("\nAnimation options\n[1] Width: %lu px\n", a->width);
+		printf("[2] Height: %lu px\n[3] Frame rate: %lu fps\n", a->height, a->fps);
+		printf("[4] Trail length: %lu frames\n", a->trail);
+		printf("[5] Output: %s\n[6] Target: %s\n", format_name(a->format), a->target);
+		printf("[7] Exit\nPlease enter your choice [1-7]: ");
+		choice = get_ulong(0);
+		switch (choice) {
+			case 1 :
+				printf("Please enter new value for width [800]: ");
+				a->width = get_ulong(800);
+				break;
+			case 2 :
+				printf("Please enter new value for height [800]: ");
+				a->height = get_ulong(800);
+				break;
+			case 3 :
+				printf("Please enter new value for frame rate [30]: ");
+				a->fps = get_ulong(30);
+				if (a->fps == 0)
+					a->fps = 30;
+				break;
+			case 4 :
+				printf("Please enter new value for trail length [30]: ");
+				a->trail = get_ulong(30);
+				break;
+			case 5 :
+				printf("[1] PPM frames\n[2] PNG frames\n[3] ffmpeg video\n");
+				printf("Please enter your choice [1]: ");
+				switch (get_ulong(1)) {
+					case 2 : a->format = ANIM_PNG; break;
+					case 3 : a->format = ANIM_PIPE; break;
+					default : a->format = ANIM_PPM; break;
+				}
+				break;
+			case 6 :
+				printf("Frames are saved as <target>_00000.ppm, ");
+				printf("videos are saved to <target>\n");
+				printf("Enter new target [%s]: ", a->target);
+				a->target = get_fname(a->target);
+				break;
+			default :
+				return;
+		}
+	}
+}
+
+void full_setup(sim_params *p, anim_params *a, triple *theta1, triple *theta2, char *csv_def, char *svg_def) {
 	ulong choice;
 	int sim_done = 0;
 	char *csv_fname = to_dynamic(csv_def);
@@ -200,8 +256,9 @@ void full_setup(sim_params *p, triple *theta1, triple *theta2, char *csv_def, ch
 		printf("\nFull trajectory simulation options\n[1] Theta 1 = %Lf\n", *theta1);
 		printf("[2] Theta 2 = %Lf\n[3] Plotting frequency: %lu Hz\n", *theta2, p->plot_freq);
 		printf("[4] Run simulation\n[5] Save data to csv\n");
-		printf("[6] Plot phase space\n");
-		printf("[7] Exit\nPlease enter your choice [1-7]: ");
+		printf("[6] Plot phase space\n[7] Animate pendulum\n");
+		printf("[8] Animate phase space\n");
+		printf("[9] Exit\nPlease enter your choice [1-9]: ");
 		choice = get_ulong(0);
 		switch (choice) {
 			case 1 :
@@ -261,6 +318,24 @@ void full_setup(sim_params *p, triple *theta1, triple *theta2, char *csv_def, ch
 				svg_fname = get_fname(svg_fname);
 				plot_phase_space(result, *p, svg_fname);
 				break;
+			case 7 :
+			case 8 :
+				if (!sim_done) {
+					free_array(result);
+					printf("No up-to-date simulation found, starting it\n");
+					result = full_sim(*theta1, *theta2, *p);
+					if (result == NULL) {
+						printf("Failed to allocate memory for results.\n");
+						break;
+					}
+					else
+						sim_done = 1;
+				}
+				if (choice == 7)
+					animate_trajectory(result, *p, *a);
+				else
+					animate_phase_space(result, *p, *a);
+				break;
 			default:
 				return;
 		}
@@ -270,7 +345,46 @@ void full_setup(sim_params *p, triple *theta1, triple *theta2, char *csv_def, ch
 	free(svg_fname);
 }
 
-void flip_setup(sim_params *p, char *ppm_def, char *img_def) {
+void sweep_setup(sim_params *p, anim_params *a, triple ***result, int *sim_done) {
+	sweep_param which;
+	triple from = 0, to = 0;
+	printf("\nParameter to sweep\n[1] g\n[2] l\n[3] t\n");
+	printf("Please enter your choice [3]: ");
+	switch (get_ulong(3)) {
+		case 1 : which = SWEEP_G; break;
+		case 2 : which = SWEEP_L; break;
+		default : which = SWEEP_T; break;
+	}
+	if (which == SWEEP_T) {
+		printf("Please enter the number of frames [%lu]: ", 5*a->fps);
+		ulong frames = get_ulong(5*a->fps);
+		/* Every horizon up to t can be read off a single flip map */
+		if (!*sim_done) {
+			flip_matrix_free(*result);
+			printf("No up-to-date simulation found, starting it\n");
+			*result = flip_matrix(*p, print_row, NULL);
+			if (*result == NULL) {
+				printf("Failed to allocate momory for results.\n");
+				return;
+			}
+			*sim_done = 1;
+		}
+		/* The map covers steps*dt, which can differ from t */
+		to = p->steps*p->dt;
+		from = frames > 0 ? to/frames : 0;
+		animate_flip_sweep(*result, *p, *a, which, from, to, frames);
+		return;
+	}
+	from = which == SWEEP_G ? p->c.g : p->c.l;
+	printf("Please enter the starting value [%Lf]: ", from);
+	from = get_triple(from);
+	printf("Please enter the final value [%Lf]: ", 2*from);
+	to = get_triple(2*from);
+	printf("Please enter the number of frames [%lu]: ", a->fps);
+	animate_flip_sweep(NULL, *p, *a, which, from, to, get_ulong(a->fps));
+}
+
+void flip_setup(sim_params *p, anim_params *a, char *ppm_def, char *img_def) {
 	ulong choice;
 	int sim_done = 0;
 	char *ppm_fname = to_dynamic(ppm_def);
@@ -283,7 +397,8 @@ void flip_setup(sim_params *p, char *ppm_def, char *img_def) {
 		printf("[1] Pixels per side: %lu\n", p->flip_length);
 		printf("[2] Run simulation\n[3] Save output to PPM\n");
 		printf("[4] Convert PPM to another image format\n");
-		printf("[5] Exit\nPlease enter your choice [1-5]: ");
+		printf("[5] Animate parameter sweep\n");
+		printf("[6] Exit\nPlease enter your choice [1-6]: ");
 		fflush(stdin);
 		choice = get_ulong(0);
 		switch (choice) {
@@ -293,9 +408,9 @@ void flip_setup(sim_params *p, char *ppm_def, char *img_def) {
 				sim_done = 0;
 				break;
 			case 2 :
-				free_matrix(result);
+				flip_matrix_free(result);
 				printf("Started simulation\n");
-				result = flip_matrix(*p);
+				result = flip_matrix(*p, print_row, NULL);
 				if (result == NULL) {
 					printf("Failed to allocate momory for results.\n");
 					sim_done = 0;
@@ -305,9 +420,9 @@ void flip_setup(sim_params *p, char *ppm_def, char *img_def) {
 				break;
 			case 3 :
 				if (!sim_done) {
-					free_matrix(result);
+					flip_matrix_free(result);
 					printf("No up-to-date simulation found, starting it\n");
-					result = flip_matrix(*p);
+					result = flip_matrix(*p, print_row, NULL);
 					if (result == NULL) {
 						printf("Failed to allocate momory for results.\n");
 						break;
@@ -326,12 +441,14 @@ void flip_setup(sim_params *p, char *ppm_def, char *img_def) {
 				img_fname = get_fname(img_fname);
 				convert_plot(ppm_fname, img_fname);
 				break;
+			case 5 :
+				sweep_setup(p, a, &result, &sim_done);
+				break;
 			default:
 				return;
 		}
 	}
-	free(result[0]);
-	free(result);
+	flip_matrix_free(result);
 	free(ppm_fname);
 	free(img_fname);
 }
@@ -353,28 +470,38 @@ int main() {
 	params.c.m = 1;
 	params.c.l = 1;
 	params.c.g = 9.81;
+	anim_params anim;
+	anim.width = 800;
+	anim.height = 800;
+	anim.fps = 30;
+	anim.trail = 30;
+	anim.format = ANIM_PPM;
+	anim.target = to_dynamic("data/frame");
 	int done = 0;
 	ulong choice;
 	while (!done) {
 		printf("\nMain menu\n[1] General options\n");
 		printf("[2] Full-trajectory simulation\n");
 		printf("[3] Flipover time simulation\n");
-		printf("[4] Exit\nPlease enter your choice [1-4]: ");
+		printf("[4] Animation options\n");
+		printf("[5] Exit\nPlease enter your choice [1-5]: ");
 		choice = get_ulong(0);
 
 		switch (choice) {
 			case 1: general_setup(&params); break;
 			case 2:
-				full_setup(&params, &theta1, &theta2, csv_def, svg_def);
+				full_setup(&params, &anim, &theta1, &theta2, csv_def, svg_def);
 				break;
 			case 3: 
-				flip_setup(&params, ppm_def, img_def);
+				flip_setup(&params, &anim, ppm_def, img_def);
 				break;
+			case 4: anim_setup(&anim); break;
 			default:
 				done = 1;
 				break;
 		}
 	}
 
+	free(anim.target);
 	return 0;
 }
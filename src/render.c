@@ -0,0 +1,695 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "render.h"
+
+#define PATH_SIZE 4096
+
+typedef struct {
+	unsigned char r;
+	unsigned char g;
+	unsigned char b;
+} colour;
+
+static const colour BACKGROUND = {255, 255, 255};
+static const colour ARM = {40, 40, 40};
+static const colour TRAIL = {200, 30, 30};
+static const colour AXIS = {180, 180, 180};
+/* Same colours as gnuplot's default palette, so the animation
+ * looks like the SVG phase space plots */
+static const colour UPPER = {148, 0, 211};
+static const colour LOWER = {0, 158, 115};
+
+/* Renders a single frame into img. Returns non-zero on failure.
+ * It gets called from multiple threads at once, so it must not
+ * touch anything but its own frame and the read-only context. */
+typedef int (*frame_fn)(ulong frame, rgb_image *img, void *ctx);
+
+rgb_image *image_new(ulong width, ulong height) {
+	rgb_image *img = (rgb_image*)malloc(sizeof(rgb_image));
+	if (img == NULL)
+		return NULL;
+	img->width = width;
+	img->height = height;
+	img->data = (unsigned char*)malloc(3*width*height);
+	if (img->data == NULL) {
+		free(img);
+		return NULL;
+	}
+	memset(img->data, 255, 3*width*height);
+	return img;
+}
+
+void image_free(rgb_image *img) {
+	if (img != NULL) {
+		free(img->data);
+		free(img);
+	}
+}
+
+static void image_clear(rgb_image *img, colour c) {
+	for (ulong i = 0; i < img->width*img->height; ++i) {
+		img->data[3*i] = c.r;
+		img->data[3*i + 1] = c.g;
+		img->data[3*i + 2] = c.b;
+	}
+}
+
+/* Mixes c into the pixel at (x, y) with the given opacity.
+ * Out of bounds coordinates are silently ignored. */
+static void blend_pixel(rgb_image *img, long x, long y, colour c, double alpha) {
+	if (x < 0 || y < 0 || (ulong)x >= img->width || (ulong)y >= img->height)
+		return;
+	unsigned char *p = img->data + 3*((ulong)y*img->width + (ulong)x);
+	p[0] = (unsigned char)(p[0] + alpha*(c.r - p[0]));
+	p[1] = (unsigned char)(p[1] + alpha*(c.g - p[1]));
+	p[2] = (unsigned char)(p[2] + alpha*(c.b - p[2]));
+}
+
+/* Coordinates further than this from the image are treated as invalid.
+ * A diverging simulation easily produces values that don't fit into
+ * a long, and clipping them wouldn't draw anything sensible anyway. */
+#define PIXEL_LIMIT 1e6
+
+static int valid_point(const rgb_image *img, double x, double y) {
+	return isfinite(x) && isfinite(y)
+		&& x > -PIXEL_LIMIT && x < img->width + PIXEL_LIMIT
+		&& y > -PIXEL_LIMIT && y < img->height + PIXEL_LIMIT;
+}
+
+/* Region code of a point for Cohen-Sutherland clipping */
+static int outcode(const rgb_image *img, double x, double y) {
+	int code = 0;
+	if (x < 0)
+		code |= 1;
+	else if (x > img->width - 1)
+		code |= 2;
+	if (y < 0)
+		code |= 4;
+	else if (y > img->height - 1)
+		code |= 8;
+	return code;
+}
+
+/* Cohen-Sutherland line clipping. Moves the endpoints onto the image
+ * and returns 0 if no part of the line is visible. */
+static int clip_line(const rgb_image *img, double *x0, double *y0,
+		double *x1, double *y1) {
+	int c0 = outcode(img, *x0, *y0), c1 = outcode(img, *x1, *y1);
+	double right = img->width - 1, bottom = img->height - 1;
+	while (c0 | c1) {
+		if (c0 & c1)
+			return 0;
+		int c = c0 ? c0 : c1;
+		double x, y;
+		if (c & 8) {
+			x = *x0 + (*x1 - *x0)*(bottom - *y0)/(*y1 - *y0);
+			y = bottom;
+		}
+		else if (c & 4) {
+			x = *x0 + (*x1 - *x0)*(0 - *y0)/(*y1 - *y0);
+			y = 0;
+		}
+		else if (c & 2) {
+			y = *y0 + (*y1 - *y0)*(right - *x0)/(*x1 - *x0);
+			x = right;
+		}
+		else {
+			y = *y0 + (*y1 - *y0)*(0 - *x0)/(*x1 - *x0);
+			x = 0;
+		}
+		if (c == c0) {
+			*x0 = x;
+			*y0 = y;
+			c0 = outcode(img, x, y);
+		}
+		else {
+			*x1 = x;
+			*y1 = y;
+			c1 = outcode(img, x, y);
+		}
+	}
+	return 1;
+}
+
+/* Bresenham's line algorithm, run on the visible part of the line */
+static void draw_line(rgb_image *img, double fx0, double fy0, double fx1,
+		double fy1, colour c, double alpha) {
+	if (!valid_point(img, fx0, fy0) || !valid_point(img, fx1, fy1)
+			|| !clip_line(img, &fx0, &fy0, &fx1, &fy1))
+		return;
+	long x0 = (long)fx0, y0 = (long)fy0, x1 = (long)fx1, y1 = (long)fy1;
+	long dx = labs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	long dy = -labs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	long err = dx + dy;
+	while (1) {
+		blend_pixel(img, x0, y0, c, alpha);
+		if (x0 == x1 && y0 == y1)
+			return;
+		long e2 = 2*err;
+		if (e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+/* Draws a 3 pixel wide line by drawing the same line with small offsets */
+static void draw_thick_line(rgb_image *img, double x0, double y0, double x1,
+		double y1, colour c) {
+	for (int ox = -1; ox <= 1; ++ox)
+		for (int oy = -1; oy <= 1; ++oy)
+			draw_line(img, x0 + ox, y0 + oy, x1 + ox, y1 + oy, c, 1);
+}
+
+static void fill_circle(rgb_image *img, double fx, double fy, long r, colour c) {
+	if (!valid_point(img, fx, fy))
+		return;
+	long cx = (long)fx, cy = (long)fy;
+	for (long y = -r; y <= r; ++y)
+		for (long x = -r; x <= r; ++x)
+			if (x*x + y*y <= r*r)
+				blend_pixel(img, cx + x, cy + y, c, 1);
+}
+
+int write_ppm(const rgb_image *img, FILE *f) {
+	fprintf(f, "P6\n%lu %lu 255\n", img->width, img->height);
+	if (fwrite(img->data, 3, img->width*img->height, f)
+			!= img->width*img->height)
+		return 1;
+	return 0;
+}
+
+/* Bitwise CRC-32 as used by PNG. A lookup table would be faster,
+ * but writing the file is nowhere near the bottleneck. */
+static unsigned long crc_update(unsigned long crc, const unsigned char *buf,
+		ulong len) {
+	crc = ~crc & 0xffffffffUL;
+	for (ulong i = 0; i < len; ++i) {
+		crc ^= buf[i];
+		for (int k = 0; k < 8; ++k)
+			crc = (crc >> 1) ^ (0xedb88320UL & (0UL - (crc & 1)));
+	}
+	return ~crc & 0xffffffffUL;
+}
+
+static void put_u32(unsigned char *buf, unsigned long n) {
+	buf[0] = (unsigned char)(n >> 24);
+	buf[1] = (unsigned char)(n >> 16);
+	buf[2] = (unsigned char)(n >> 8);
+	buf[3] = (unsigned char)n;
+}
+
+/* Writes data to f and folds it into the running CRC of the current chunk */
+static void chunk_write(const unsigned char *data, ulong len, FILE *f,
+		unsigned long *crc) {
+	fwrite(data, 1, len, f);
+	*crc = crc_update(*crc, data, len);
+}
+
+static void chunk_begin(const char *type, unsigned long len, FILE *f,
+		unsigned long *crc) {
+	unsigned char buf[4];
+	put_u32(buf, len);
+	fwrite(buf, 1, 4, f);
+	*crc = 0;
+	chunk_write((const unsigned char*)type, 4, f, crc);
+}
+
+static void chunk_end(FILE *f, unsigned long crc) {
+	unsigned char buf[4];
+	put_u32(buf, crc);
+	fwrite(buf, 1, 4, f);
+}
+
+/* The image data is stored in uncompressed deflate blocks, which keeps
+ * the writer short and fast. The files are larger than they need to be,
+ * but the encoder is expected to take care of that. */
+int write_png(const rgb_image *img, FILE *f) {
+	static const unsigned char signature[8] =
+		{137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	unsigned char buf[13];
+	unsigned long crc;
+	ulong row = 3*img->width + 1;
+	ulong raw = row*img->height;
+	ulong blocks = raw/65535 + (raw % 65535 != 0);
+	unsigned long s1 = 1, s2 = 0;
+
+	fwrite(signature, 1, 8, f);
+
+	put_u32(buf, img->width);
+	put_u32(buf + 4, img->height);
+	buf[8] = 8;  /* bit depth */
+	buf[9] = 2;  /* truecolour */
+	buf[10] = buf[11] = buf[12] = 0;
+	chunk_begin("IHDR", 13, f, &crc);
+	chunk_write(buf, 13, f, &crc);
+	chunk_end(f, crc);
+
+	chunk_begin("IDAT", 2 + 5*blocks + raw + 4, f, &crc);
+	buf[0] = 0x78;
+	buf[1] = 0x01;
+	chunk_write(buf, 2, f, &crc);
+	/* Walk through the filtered stream (a zero filter byte before every
+	 * row), splitting it into blocks of at most 65535 bytes. */
+	ulong pos = 0;
+	while (pos < raw) {
+		ulong len = raw - pos < 65535 ? raw - pos : 65535;
+		buf[0] = pos + len == raw;
+		buf[1] = (unsigned char)len;
+		buf[2] = (unsigned char)(len >> 8);
+		buf[3] = (unsigned char)~len;
+		buf[4] = (unsigned char)(~len >> 8);
+		chunk_write(buf, 5, f, &crc);
+		for (ulong end = pos + len; pos < end;) {
+			ulong y = pos / row, x = pos % row;
+			const unsigned char *src;
+			ulong n;
+			if (x == 0) {
+				src = buf + 5;
+				buf[5] = 0;
+				n = 1;
+			}
+			else {
+				src = img->data + y*3*img->width + x - 1;
+				n = row - x < end - pos ? row - x : end - pos;
+			}
+			chunk_write(src, n, f, &crc);
+			for (ulong i = 0; i < n; ++i) {
+				s1 = (s1 + src[i]) % 65521;
+				s2 = (s2 + s1) % 65521;
+			}
+			pos += n;
+		}
+	}
+	put_u32(buf, (s2 << 16) | s1);
+	chunk_write(buf, 4, f, &crc);
+	chunk_end(f, crc);
+
+	chunk_begin("IEND", 0, f, &crc);
+	chunk_end(f, crc);
+
+	return ferror(f) != 0;
+}
+
+/* Name of the video file. ffmpeg picks the container from the extension,
+ * so targets without one (like the default) get ".mp4" appended. */
+static void video_name(anim_params anim, char *buf) {
+	const char *base = strrchr(anim.target, '/');
+	base = base == NULL ? anim.target : base + 1;
+	snprintf(buf, PATH_SIZE, "%s%s", anim.target,
+			strchr(base, '.') == NULL ? ".mp4" : "");
+}
+
+/* Opens the encoder pipe, checking for ffmpeg the same way
+ * plot_phase_space checks for gnuplot. */
+static FILE *open_encoder(anim_params anim) {
+	char command[PATH_SIZE + 256], fname[PATH_SIZE];
+	#ifdef _WIN32
+		if (system("where ffmpeg 2> nul 1> nul"))
+			return NULL;
+	#else
+		if (system("which ffmpeg 2> /dev/null 1> /dev/null"))
+			return NULL;
+	#endif
+	video_name(anim, fname);
+	snprintf(command, sizeof(command), "ffmpeg -loglevel error -y -f rawvideo "
+			"-pix_fmt rgb24 -s %lux%lu -r %lu -i - -pix_fmt yuv420p \"%s\"",
+			anim.width, anim.height, anim.fps, fname);
+	#ifdef _WIN32
+		return _popen(command, "wb");
+	#else
+		return popen(command, "w");
+	#endif
+}
+
+static int write_frame(const rgb_image *img, ulong frame, anim_params anim,
+		FILE *pipe) {
+	char fname[PATH_SIZE];
+	int failed;
+	if (anim.format == ANIM_PIPE)
+		return fwrite(img->data, 3, img->width*img->height, pipe)
+			!= img->width*img->height;
+	snprintf(fname, PATH_SIZE, "%s_%05lu.%s", anim.target, frame,
+			anim.format == ANIM_PNG ? "png" : "ppm");
+	FILE *f = fopen(fname, "wb");
+	if (f == NULL) {
+		printf("Failed to open %s for writing.\n", fname);
+		return 1;
+	}
+	if (anim.format == ANIM_PNG)
+		failed = write_png(img, f);
+	else
+		failed = write_ppm(img, f);
+	fclose(f);
+	return failed;
+}
+
+/* Renders frames in batches of one frame per thread, then writes each
+ * batch in order, so the encoder pipe receives the frames sequentially. */
+static int render_animation(frame_fn fn, void *ctx, ulong frames,
+		anim_params anim) {
+	FILE *pipe = NULL;
+	long batch = 1;
+	int failed = 0;
+	char fname[PATH_SIZE];
+	#ifndef _WIN32
+		void (*old_handler)(int) = SIG_DFL;
+	#endif
+	#ifdef _OPENMP
+		batch = omp_get_max_threads();
+	#endif
+	if (frames == 0 || anim.width == 0 || anim.height == 0) {
+		printf("Nothing to render.\n");
+		return 1;
+	}
+	/* yuv420p stores colour at half resolution in both directions */
+	if (anim.format == ANIM_PIPE && (anim.width % 2 || anim.height % 2)) {
+		printf("Video width and height must be even.\n");
+		return 1;
+	}
+	rgb_image **imgs = (rgb_image**)calloc(batch, sizeof(rgb_image*));
+	if (imgs == NULL) {
+		printf("Failed to allocate memory for frames.\n");
+		return 1;
+	}
+	for (long b = 0; b < batch; ++b) {
+		imgs[b] = image_new(anim.width, anim.height);
+		if (imgs[b] == NULL) {
+			printf("Failed to allocate memory for frames.\n");
+			failed = 1;
+			goto cleanup;
+		}
+	}
+	if (anim.format == ANIM_PIPE) {
+		pipe = open_encoder(anim);
+		if (pipe == NULL) {
+			printf("ffmpeg could not be found, no video will be saved.\n");
+			failed = 1;
+			goto cleanup;
+		}
+		/* If ffmpeg exits early, writing to the pipe would kill the
+		 * whole program with SIGPIPE. Ignoring it makes fwrite fail
+		 * with EPIPE instead, which is handled as a failed frame. */
+		#ifndef _WIN32
+			old_handler = signal(SIGPIPE, SIG_IGN);
+		#endif
+	}
+
+	for (ulong start = 0; start < frames && !failed; start += batch) {
+		long n = frames - start < (ulong)batch ? (long)(frames - start) : batch;
+		long b;
+		#ifdef _OPENMP
+			#pragma omp parallel for schedule(dynamic) reduction(|:failed)
+		#endif
+		for (b = 0; b < n; ++b)
+			failed |= fn(start + b, imgs[b], ctx);
+		for (b = 0; b < n && !failed; ++b)
+			failed |= write_frame(imgs[b], start + b, anim, pipe);
+		printf("Frame %5lu/%lu rendered\n", start + n, frames);
+	}
+
+	if (pipe != NULL) {
+		int status;
+		#ifdef _WIN32
+			status = _pclose(pipe);
+		#else
+			status = pclose(pipe);
+			signal(SIGPIPE, old_handler);
+		#endif
+		if (status != 0) {
+			printf("ffmpeg exited with an error, no video was saved.\n");
+			failed = 1;
+		}
+	}
+	if (!failed) {
+		if (anim.format == ANIM_PIPE) {
+			video_name(anim, fname);
+			printf("Animation saved to %s\n", fname);
+		}
+		else
+			printf("Frames saved as %s_*.%s\n", anim.target,
+					anim.format == ANIM_PNG ? "png" : "ppm");
+	}
+cleanup:
+	for (long b = 0; b < batch; ++b)
+		image_free(imgs[b]);
+	free(imgs);
+	return failed;
+}
+
+/* Number of frames needed to show every simulated step at anim.fps */
+static ulong frame_count(sim_params params, anim_params anim) {
+	if (params.steps == 0 || params.freq == 0)
+		return 0;
+	return (params.steps - 1)*anim.fps/params.freq + 1;
+}
+
+/* Index of the simulation step shown in the given frame */
+static ulong frame_step(ulong frame, sim_params params, anim_params anim) {
+	ulong step = frame*params.freq/anim.fps;
+	return step < params.steps ? step : params.steps - 1;
+}
+
+static ulong plot_skip(sim_params params) {
+	ulong skip = params.freq / params.plot_freq;
+	return skip < 1 ? 1 : skip;
+}
+
+typedef struct {
+	pend_state *states;
+	sim_params params;
+	anim_params anim;
+	double scale;
+} trajectory_ctx;
+
+/* Screen coordinates of the two bobs. The angles are measured from the
+ * downward vertical, and the image's y axis points downwards as well. */
+static void bob_positions(pend_state s, const trajectory_ctx *ctx, double *pos) {
+	double ox = ctx->anim.width/2.0, oy = ctx->anim.height/2.0;
+	double l = ctx->scale*(double)ctx->params.c.l;
+	double x1 = ox + l*sin((double)s.t1), y1 = oy + l*cos((double)s.t1);
+	pos[0] = x1;
+	pos[1] = y1;
+	pos[2] = x1 + l*sin((double)s.t2);
+	pos[3] = y1 + l*cos((double)s.t2);
+}
+
+static int trajectory_frame(ulong frame, rgb_image *img, void *data) {
+	const trajectory_ctx *ctx = (const trajectory_ctx*)data;
+	ulong step = frame_step(frame, ctx->params, ctx->anim);
+	ulong length = ctx->anim.trail*ctx->params.freq/ctx->anim.fps;
+	ulong first = step > length ? step - length : 0;
+	ulong skip = plot_skip(ctx->params);
+	double pos[4], prev[4];
+
+	image_clear(img, BACKGROUND);
+
+	/* Trail of the lower bob, fading out towards its older end */
+	bob_positions(ctx->states[first], ctx, prev);
+	for (ulong i = first + skip; i <= step; i += skip) {
+		bob_positions(ctx->states[i], ctx, pos);
+		draw_line(img, prev[2], prev[3], pos[2], pos[3], TRAIL,
+				(double)(i - first)/(step - first + 1));
+		memcpy(prev, pos, sizeof(pos));
+	}
+
+	bob_positions(ctx->states[step], ctx, pos);
+	draw_thick_line(img, img->width/2.0, img->height/2.0,
+			pos[0], pos[1], ARM);
+	draw_thick_line(img, pos[0], pos[1], pos[2], pos[3], ARM);
+	fill_circle(img, pos[0], pos[1], 6, ARM);
+	fill_circle(img, pos[2], pos[3], 6, TRAIL);
+	return 0;
+}
+
+int animate_trajectory(pend_state *states, sim_params params,
+		anim_params anim) {
+	trajectory_ctx ctx;
+	ulong side = anim.width < anim.height ? anim.width : anim.height;
+	ctx.states = states;
+	ctx.params = params;
+	ctx.anim = anim;
+	/* Both arms together take up 90% of the shorter side */
+	ctx.scale = 0.45*side/(2*(double)params.c.l);
+	return render_animation(trajectory_frame, &ctx,
+			frame_count(params, anim), anim);
+}
+
+typedef struct {
+	pend_state *states;
+	sim_params params;
+	anim_params anim;
+	double t_min, t_max;
+	double p_min, p_max;
+} phase_ctx;
+
+#define PHASE_MARGIN 20
+
+/* Non-finite states map to non-finite coordinates,
+ * which the drawing functions skip */
+static double phase_x(const phase_ctx *ctx, triple t) {
+	return PHASE_MARGIN + ((double)t - ctx->t_min)/(ctx->t_max - ctx->t_min)
+		*(ctx->anim.width - 2*PHASE_MARGIN);
+}
+
+static double phase_y(const phase_ctx *ctx, triple p) {
+	return ctx->anim.height - PHASE_MARGIN
+		- ((double)p - ctx->p_min)/(ctx->p_max - ctx->p_min)
+		*(ctx->anim.height - 2*PHASE_MARGIN);
+}
+
+/* Widens [*min, *max] to include v, ignoring infinities and NaNs,
+ * so a diverging simulation doesn't make the whole range infinite */
+static void extend_range(double *min, double *max, triple v) {
+	double d = (double)v;
+	if (!isfinite(d))
+		return;
+	*min = fmin(*min, d);
+	*max = fmax(*max, d);
+}
+
+static int phase_frame(ulong frame, rgb_image *img, void *data) {
+	const phase_ctx *ctx = (const phase_ctx*)data;
+	const pend_state *s = ctx->states;
+	ulong step = frame_step(frame, ctx->params, ctx->anim);
+	ulong skip = plot_skip(ctx->params);
+	ulong prev = 0;
+
+	image_clear(img, BACKGROUND);
+
+	/* Axes through the origin */
+	draw_line(img, 0, phase_y(ctx, 0), img->width - 1, phase_y(ctx, 0), AXIS, 1);
+	draw_line(img, phase_x(ctx, 0), 0, phase_x(ctx, 0), img->height - 1, AXIS, 1);
+
+	for (ulong i = skip; i <= step; i += skip) {
+		draw_line(img, phase_x(ctx, s[prev].t1), phase_y(ctx, s[prev].p1),
+				phase_x(ctx, s[i].t1), phase_y(ctx, s[i].p1), UPPER, 1);
+		draw_line(img, phase_x(ctx, s[prev].t2), phase_y(ctx, s[prev].p2),
+				phase_x(ctx, s[i].t2), phase_y(ctx, s[i].p2), LOWER, 1);
+		prev = i;
+	}
+	fill_circle(img, phase_x(ctx, s[step].t1), phase_y(ctx, s[step].p1), 4, UPPER);
+	fill_circle(img, phase_x(ctx, s[step].t2), phase_y(ctx, s[step].p2), 4, LOWER);
+	return 0;
+}
+
+int animate_phase_space(pend_state *states, sim_params params,
+		anim_params anim) {
+	phase_ctx ctx;
+	ctx.states = states;
+	ctx.params = params;
+	ctx.anim = anim;
+	if (anim.width <= 2*PHASE_MARGIN || anim.height <= 2*PHASE_MARGIN) {
+		printf("Image is too small for a phase space plot.\n");
+		return 1;
+	}
+	/* Both pendulums share the axes, like in the gnuplot output */
+	ctx.t_min = ctx.t_max = 0;
+	ctx.p_min = ctx.p_max = 0;
+	for (ulong i = 0; i < params.steps; ++i) {
+		extend_range(&ctx.t_min, &ctx.t_max, states[i].t1);
+		extend_range(&ctx.t_min, &ctx.t_max, states[i].t2);
+		extend_range(&ctx.p_min, &ctx.p_max, states[i].p1);
+		extend_range(&ctx.p_min, &ctx.p_max, states[i].p2);
+	}
+	if (ctx.t_max == ctx.t_min)
+		ctx.t_max = ctx.t_min + 1;
+	if (ctx.p_max == ctx.p_min)
+		ctx.p_max = ctx.p_min + 1;
+	return render_animation(phase_frame, &ctx, frame_count(params, anim), anim);
+}
+
+typedef struct {
+	triple **data;
+	sim_params params;
+	anim_params anim;
+	sweep_param which;
+	triple from, to;
+	ulong frames;
+} sweep_ctx;
+
+/* Draws the flip map scaled to the image with nearest neighbour sampling.
+ * Flip times after the horizon t are shown as if the pendulum never
+ * flipped, using the same colour scheme as flip_plot. */
+static void draw_flip_map(rgb_image *img, triple **data, ulong length, triple t) {
+	for (ulong y = 0; y < img->height; ++y) {
+		const triple *row = data[y*length/img->height];
+		unsigned char *p = img->data + 3*y*img->width;
+		for (ulong x = 0; x < img->width; ++x, p += 3) {
+			triple v = row[x*length/img->width];
+			if (v > t)
+				v = -1;
+			unsigned char col = (unsigned char)(255*(v + 1)/(t + 1));
+			p[0] = col;
+			p[1] = 0;
+			p[2] = (255 - col)/5;
+		}
+	}
+}
+
+/* The flip map only covers params.steps steps, which isn't updated
+ * when t is changed in the menu, so params.t can't be trusted here */
+static triple simulated_time(sim_params params) {
+	return params.steps*params.dt;
+}
+
+static int sweep_frame(ulong frame, rgb_image *img, void *data) {
+	const sweep_ctx *ctx = (const sweep_ctx*)data;
+	sim_params params = ctx->params;
+	triple value = ctx->from;
+	triple **result;
+	if (ctx->frames > 1)
+		value += (ctx->to - ctx->from)*frame/(ctx->frames - 1);
+
+	if (ctx->which == SWEEP_T) {
+		draw_flip_map(img, ctx->data, params.flip_length, value);
+		return 0;
+	}
+	if (ctx->which == SWEEP_G)
+		params.c.g = value;
+	else
+		params.c.l = value;
+	result = flip_matrix(params, NULL, NULL);
+	if (result == NULL)
+		return 1;
+	draw_flip_map(img, result, params.flip_length, simulated_time(params));
+	flip_matrix_free(result);
+	return 0;
+}
+
+int animate_flip_sweep(triple **data, sim_params params, anim_params anim,
+		sweep_param which, triple from, triple to, ulong frames) {
+	sweep_ctx ctx;
+	if (which == SWEEP_T && (data == NULL || from > simulated_time(params)
+			|| to > simulated_time(params))) {
+		printf("The time horizon cannot exceed the simulated time.\n");
+		return 1;
+	}
+	if (params.flip_length == 0) {
+		printf("Nothing to render.\n");
+		return 1;
+	}
+	ctx.data = data;
+	ctx.params = params;
+	ctx.anim = anim;
+	ctx.which = which;
+	ctx.from = from;
+	ctx.to = to;
+	ctx.frames = frames;
+	return render_animation(sweep_frame, &ctx, frames, anim);
+}
@@ -0,0 +1,71 @@
+/* Double inclusion guard */
+#ifndef RENDER_H_INCLUDED
+#define RENDER_H_INCLUDED
+
+#include <stdio.h>
+
+#include "sim.h"
+
+/* Raw 24 bit RGB image, stored row by row without padding. */
+typedef struct {
+	ulong width;
+	ulong height;
+	unsigned char *data;
+} rgb_image;
+
+/* Output formats for the animations. PPM and PNG write one numbered file
+ * per frame, PIPE sends the raw frames to an external encoder (ffmpeg). */
+typedef enum {
+	ANIM_PPM,
+	ANIM_PNG,
+	ANIM_PIPE
+} anim_format;
+
+/* Stores the parameters of an animation. */
+typedef struct {
+	ulong width;
+	ulong height;
+	ulong fps;
+	ulong trail;
+	anim_format format;
+	char *target;
+} anim_params;
+
+/* Parameters that can be varied in a flip map sweep. */
+typedef enum {
+	SWEEP_G,
+	SWEEP_L,
+	SWEEP_T
+} sweep_param;
+
+/* Allocates a new image and clears it to white. Returns NULL on failure. */
+rgb_image *image_new(ulong width, ulong height);
+
+/* Frees an image created by image_new. */
+void image_free(rgb_image *img);
+
+/* Writes the image to an already opened file as a binary PPM. */
+int write_ppm(const rgb_image *img, FILE *f);
+
+/* Writes the image to an already opened file as an uncompressed PNG. */
+int write_png(const rgb_image *img, FILE *f);
+
+/* Renders the arms of the pendulum and a fading trail of the lower bob
+ * for every frame of the trajectory in states. */
+int animate_trajectory(pend_state *states, sim_params params,
+		anim_params anim);
+
+/* Renders the phase space trajectory up to the current point in time
+ * for every frame of the trajectory in states. */
+int animate_phase_space(pend_state *states, sim_params params,
+		anim_params anim);
+
+/* Animates the flip map while g, l or the time horizon varies between
+ * from and to. For the time horizon, data must contain the result of
+ * flip_matrix(params) with params.steps*params.dt >= to, and nothing
+ * is recomputed.
+ * Otherwise data is ignored and may be NULL. */
+int animate_flip_sweep(triple **data, sim_params params, anim_params anim,
+		sweep_param which, triple from, triple to, ulong frames);
+
+#endif
@@ -1,52 +1,41 @@
 #include <math.h>
-#include <stdio.h>
 #include <stdlib.h>
 
+#include "sim.h"
+
 #define PI 3.14159265358979323846264338328
 
-typedef long double triple;
-typedef unsigned long int ulong;
-
-typedef struct {
-        triple l;
-        triple m;
-        triple g;
-} constants;
-
-typedef struct {
-        triple t1;
-        triple t2;
-        triple p1;
-        triple p2;
-} pend_state;
-
-typedef struct {
-        ulong steps;
-        triple dt;
-        triple t;
-        ulong freq;
-        ulong plot_freq;
-        ulong flip_length;
-				constants c;
-} sim_params;
-
-triple d_theta_1(triple t1, triple t2, triple p1, triple p2, constants c) {
+/* MULTIVERSION clones the loops per instruction set (chosen at startup via ifunc, glibc only),
+ * KERNEL inlines the kernels into each clone. No gain while triple is long double (x87). */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__GLIBC__) \
+	&& !defined(__clang__) && __GNUC__ >= 6
+#define KERNEL static inline __attribute__((always_inline))
+#define MULTIVERSION __attribute__((target_clones("default", "avx2", "avx512f")))
+#elif defined(__GNUC__)
+#define KERNEL static inline __attribute__((always_inline))
+#define MULTIVERSION
+#else
+#define KERNEL static
+#define MULTIVERSION
+#endif
+
+KERNEL triple d_theta_1(triple t1, triple t2, triple p1, triple p2, constants c) {
         return (6/(c.m*pow(c.l, 2)))*(2*p1-3*cosl(t1 - t2)*p2)/(16 - 9*pow(cosl(t1 - t2), 2));
 }
 
-triple d_theta_2(triple t1, triple t2, triple p1, triple p2, constants c) {
+KERNEL triple d_theta_2(triple t1, triple t2, triple p1, triple p2, constants c) {
         return (6/(c.m*pow(c.l, 2)))*(8*p2-3*cosl(t1 - t2)*p1)/(16 - 9*pow(cosl(t1 - t2), 2));
 }
 
-triple d_p_1(triple t1, triple t2, triple dt1, triple dt2, constants c) {
+KERNEL triple d_p_1(triple t1, triple t2, triple dt1, triple dt2, constants c) {
         return -0.5 * c.m * pow(c.l, 2) * (dt1 * dt2 * sinl(t1 - t2) + 3*c.g*sinl(t1)/c.l);
 }
 
-triple d_p_2(triple t1, triple t2, triple dt1, triple dt2, constants c) {
+KERNEL triple d_p_2(triple t1, triple t2, triple dt1, triple dt2, constants c) {
         return -0.5 * c.m * pow(c.l, 2) * (-dt1 * dt2 * sinl(t1 - t2) + c.g*sinl(t2)/c.l);
 }
 
-triple triple_abs(triple n) {
+KERNEL triple triple_abs(triple n) {
         return (n < 0 ? -n : n);
 }
 
@@ -55,7 +44,7 @@ triple triple_abs(triple n) {
  * function on its own. It's probably a good idea to enable compiler
  * optimizations, since the code uses tons of function calls that might
  * as well be inlined, but were separated for readability. */
-pend_state step_sim(pend_state old, pend_state prev, constants c, triple h) {
+KERNEL pend_state step_sim(pend_state old, pend_state prev, constants c, triple h) {
 
         /* These are technically the intermediate values of the derivatives,
          * but they need the same fields as the state. */
@@ -111,28 +100,47 @@ pend_state step_sim(pend_state old, pend_state prev, constants c, triple h) {
                 return new;
 }
 
-pend_state *full_sim(triple theta1_0, triple theta2_0, sim_params params) {
-
-        pend_state *states =
-                (pend_state*)malloc(params.steps*sizeof(pend_state));
-        if (states == NULL)
-                return NULL;
+void sim_run_init(sim_run *run, triple theta1_0, triple theta2_0,
+                sim_params params) {
+        run->params = params;
+        run->step = 0;
         /* The first two instants are the same, because
          * we take a numerical derivative later on */
-        states[0].t1 = states[1].t1 = theta1_0;
-        states[0].t2 = states[1].t2 = theta2_0;
-        states[0].p1 = states[1].p1 = 0;
-        states[0].p2 = states[1].p2 = 0;
+        run->old.t1 = run->prev.t1 = theta1_0;
+        run->old.t2 = run->prev.t2 = theta2_0;
+        run->old.p1 = run->prev.p1 = 0;
+        run->old.p2 = run->prev.p2 = 0;
+}
 
-        triple h = params.dt / 2;
+MULTIVERSION ulong sim_run_step(sim_run *run, pend_state *buf, ulong count) {
+        triple h = run->params.dt / 2;
+        ulong n = 0;
 
-        for (ulong i = 2; i < params.steps; ++i)
-                states[i] = step_sim(states[i-2], states[i-1], params.c, h);
+        for (; n < count && run->step < run->params.steps; ++n, ++run->step) {
+                if (run->step < 2) {
+                        buf[n] = run->prev;
+                        continue;
+                }
+                buf[n] = step_sim(run->old, run->prev, run->params.c, h);
+                run->old = run->prev;
+                run->prev = buf[n];
+        }
+
+        return n;
+}
 
+pend_state *full_sim(triple theta1_0, triple theta2_0, sim_params params) {
+        sim_run run;
+        pend_state *states =
+                (pend_state*)malloc(params.steps*sizeof(pend_state));
+        if (states == NULL)
+                return NULL;
+        sim_run_init(&run, theta1_0, theta2_0, params);
+        sim_run_step(&run, states, params.steps);
         return states;
 }
 
-triple flip_sim(triple theta1, triple theta2, sim_params params) {
+MULTIVERSION static triple flip_sim(triple theta1, triple theta2, sim_params params) {
         pend_state old, prev, current;
         old.t1 = prev.t1 = theta1;
         old.t2 = prev.t2 = theta2;
@@ -149,44 +157,56 @@ triple flip_sim(triple theta1, triple theta2, sim_params params) {
         return -1;
 }
 
-/* This doesn't really need a long int, but on my
- * machine size_t is an unsigned long int and I
- * need to print it later, so I figure this is
- * probably a good way to not accidentally
- * break string format specifiers on other platforms. */
-triple* linspace(ulong length) {
+/* Starting angle of the i-th row or column of the flip map,
+ * evenly spaced between -PI and PI. */
+static triple flip_theta(ulong i, ulong length) {
         triple step = (triple)(2*PI)/(length - 1);
-        triple *result = (triple*)malloc(length*sizeof(triple));
-        if (result == NULL)
-                return NULL;
-        for (ulong i = 0; i < length; ++i)
-                result[i] = i*step - PI;
-        return result;
+        return i*step - PI;
 }
 
-triple** matrix(ulong length) {
+static triple **matrix(ulong length) {
         triple **result = (triple**)malloc(length*sizeof(triple*));
         if (result == NULL)
                 return NULL;
         result[0] = (triple*)malloc(length*length*sizeof(triple));
-        if (result[0] == NULL)
+        if (result[0] == NULL) {
+                free(result);
                 return NULL;
+        }
         for (ulong i = 1; i < length; ++i)
                 result[i] = result[0] + i * length;
         return result;
 }
 
-triple **flip_matrix(sim_params params) {
-        triple *thetas = linspace(params.flip_length);
+int flip_matrix_into(sim_params params, triple *out,
+                flip_progress progress, void *data) {
+        ulong length = params.flip_length;
+        for (ulong i = 0; i < length; ++i) {
+                triple theta1 = flip_theta(i, length);
+                for (ulong j = 0; j < length; ++j)
+                        out[i*length + j] =
+                                flip_sim(theta1, flip_theta(j, length), params);
+                if (progress != NULL && progress(i + 1, length, data))
+                        return SIM_CANCELLED;
+        }
+        return SIM_OK;
+}
+
+triple **flip_matrix(sim_params params, flip_progress progress, void *data) {
         triple **results = matrix(params.flip_length);
-        if (thetas == NULL || results == NULL)
+        if (results == NULL)
+                return NULL;
+        if (flip_matrix_into(params, results[0], progress, data) != SIM_OK) {
+                free(results[0]);
+                free(results);
                 return NULL;
-        for (ulong i = 0; i < params.flip_length; ++i) {
-                for (ulong j = 0; j < params.flip_length; ++j) {
-                        results[i][j] = flip_sim(thetas[i], thetas[j], params);
-                }
-                printf("Row %3lu/%lu computed\n", i + 1, params.flip_length);
         }
-        free(thetas);
         return results;
 }
+
+void flip_matrix_free(triple **m) {
+        if (m != NULL) {
+                free(m[0]);
+                free(m);
+        }
+}
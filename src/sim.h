@@ -2,6 +2,23 @@
 #ifndef SIM_H_INCLUDED
 #define SIM_H_INCLUDED
 
+/* This header is also installed as dpsim.h for programs embedding the
+ * engine. Note that it defines short, generic type names (triple, ulong,
+ * constants, pend_state, sim_params, sim_run), which may collide with
+ * names in the embedding program. */
+
+/* Marks the functions exported from libdpsim.so,
+ * which is built with every other symbol hidden. */
+#if defined(__GNUC__)
+#define DPSIM_API __attribute__((visibility("default")))
+#else
+#define DPSIM_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Prceice floating poit type for the calculations.
  * The name isn't quite correct, since it's
  * most likely 80 bits, but it'll do for now.
@@ -37,14 +54,59 @@ typedef struct {
 				constants c;
 } sim_params;
 
+/* Stores the progress of a full trajectory simulation, so it can be
+ * stepped in chunks. It holds no pointers, so it can live anywhere
+ * and be reused by calling sim_run_init again. */
+typedef struct {
+        sim_params params;
+        pend_state old;
+        pend_state prev;
+        ulong step;
+} sim_run;
+
+/* Return values of the functions that can be cancelled */
+#define SIM_OK 0
+#define SIM_CANCELLED 1
+
+/* Called after every row of a flip map with the number of rows done so far.
+ * Returning non-zero cancels the computation. */
+typedef int (*flip_progress)(ulong row, ulong rows, void *data);
+
+/* None of the functions below print anything or use global state,
+ * so they may be called from multiple threads at once. */
+
+/* Sets up a run starting from rest at the given angles. */
+DPSIM_API void sim_run_init(sim_run *run, triple theta1_0, triple theta2_0,
+                sim_params params);
+
+/* Writes the next (at most count) states of the run into buf and returns
+ * the number of states written, which is 0 once params.steps is reached. */
+DPSIM_API ulong sim_run_step(sim_run *run, pend_state *buf, ulong count);
+
 /* This function runs a simulation with the given parameters and stores every
  * intermediate state in a dynamic array. It returns a pointer to this array
- * when the simulation finishes. */
-pend_state *full_sim(triple theta1_0, triple theta2_0, sim_params params);
+ * when the simulation finishes (NULL if the allocation failed).
+ * The caller owns the array and releases it with free(). */
+DPSIM_API pend_state *full_sim(triple theta1_0, triple theta2_0, sim_params params);
 
 /* Runs params.flip_length^2 simulations until the lower pendulum flips over
- * and returns a dynamic matrix with the time it took for each simulation
- * (-1 if the pendulum did not flip during the simulation). */
-triple **flip_matrix(sim_params params);
+ * and stores the time it took for each simulation (-1 if the pendulum did
+ * not flip during the simulation) row by row in out, which must hold
+ * params.flip_length^2 elements. Returns SIM_OK or SIM_CANCELLED. */
+DPSIM_API int flip_matrix_into(sim_params params, triple *out,
+                flip_progress progress, void *data);
+
+/* Same as flip_matrix_into, but returns a dynamic matrix with the results,
+ * or NULL if the allocation failed or the computation was cancelled.
+ * progress may be NULL. The matrix is two allocations (the row pointers and
+ * one block of elements), so it must be released with flip_matrix_free. */
+DPSIM_API triple **flip_matrix(sim_params params, flip_progress progress, void *data);
+
+/* Frees a matrix returned by flip_matrix. Does nothing on NULL. */
+DPSIM_API void flip_matrix_free(triple **m);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
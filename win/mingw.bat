@@ -1 +1 @@
-gcc -o bin/dpsim.exe src/main.c src/input.c src/sim.c -O2 -Wall -Werror
+gcc -o bin/dpsim.exe src/main.c src/input.c src/sim.c src/render.c -O2 -fopenmp -Wall -Werror
@@ -1 +1 @@
-cl .\src\main.c .\src\input.c .\src\sim.c /link /out:bin\dpsim.exe
+cl /openmp .\src\main.c .\src\input.c .\src\sim.c .\src\render.c /link /out:bin\dpsim.exe